@@ -8,7 +8,9 @@
 
 #define DEG2RAD (3.14/180.0)
 
-#define randfloat() ((float)rand()/(float)RAND_MAX)
+// [0,1) unlike the old rand()/RAND_MAX which was [0,1], needs the Random section below.
+// Seed it with rng_thread_seed(), srand() no longer has any effect on it.
+#define randfloat() rng_float(rng_thread())
 
 /* tag Dynamic arrays */
 
@@ -187,6 +189,171 @@ bool nonblocking_scanf(int* ret, const char* fmt, ...) {
 
 }
 
+/* Buffered stdin reader, cheaper alternative to nonblocking_scanf for poll loops.
+ * Stdin is set nonblocking once, read in big chunks, and split into lines in place.
+ * Use stdin_reader_wait() as the loop's sleep: when nothing is typed the only
+ * syscall per tick is the poll() that replaces usleep(). Lines are handed out as
+ * NUL terminated views into the buffer, valid until the next stdin_reader_wait().
+ * reader.eof is set once stdin is closed or fails and the last line was handed out
+ * when stdin_reader_next_line() returns false with it set.
+ *
+ *     Stdin_Reader reader;
+ *     stdin_reader_init(&reader);
+ *     while (running) {
+ *         Line line;
+ *         while (stdin_reader_next_line(&reader, &line)) {
+ *             long x; double y;
+ *             if (line_next_long(&line, &x) && line_next_double(&line, &y)) ...
+ *         }
+ *         update();
+ *         stdin_reader_wait(&reader, 16);
+ *     }
+ */
+#ifndef STDIN_READER_CAP
+#define STDIN_READER_CAP 4096
+#endif
+
+typedef struct {
+    char*  items;
+    size_t count;
+} Line;
+
+typedef struct {
+    char   buf[STDIN_READER_CAP];
+    size_t start; // first byte not handed out yet
+    size_t scan;  // [start, scan) is known to have no '\n'
+    size_t end;   // one past the last byte read
+    bool   eof;   // stdin closed or failed
+} Stdin_Reader;
+
+int stdin_reader_init(Stdin_Reader* r) {
+    r->start = r->scan = r->end = 0;
+    r->eof = false;
+    return set_stdin_nonblocking();
+}
+
+static bool stdin_reader__has_line(Stdin_Reader* r) {
+    if (memchr(r->buf + r->scan, '\n', r->end - r->scan) != NULL) return true;
+    r->scan = r->end;
+    if (r->start == r->end) return false;
+    // Leftover without newline only counts at EOF or when it fills the whole buffer
+    return r->eof || r->end - r->start == sizeof(r->buf) - 1;
+}
+
+static void stdin_reader__fill(Stdin_Reader* r) {
+    if (r->start == r->end) {
+        r->start = r->scan = r->end = 0;
+    } else if (r->start > 0) {
+        memmove(r->buf, r->buf + r->start, r->end - r->start);
+        r->scan -= r->start;
+        r->end  -= r->start;
+        r->start = 0;
+    }
+    for (;;) {
+        size_t room = sizeof(r->buf) - 1 - r->end; // keep a byte for the last NUL
+        if (room == 0) return;
+        ssize_t n = read(STDIN_FILENO, r->buf + r->end, room);
+        if (n > 0) {
+            r->end += n;
+            if ((size_t)n < room) return; // drained, skip the EAGAIN round trip
+        } else if (n == 0) {
+            r->eof = true;
+            return;
+        } else if (errno != EINTR) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) r->eof = true;
+            return;
+        }
+    }
+}
+
+/* Returns true as soon as a line is ready, otherwise false after the full
+ * timeout_ms (0 to just check, negative to wait forever). No syscalls if a line
+ * is already buffered. Partial input or signals don't cut the wait short, and
+ * after EOF it still sleeps (a negative timeout blocks until a signal), so check r->eof to tell "no input yet" from
+ * "input finished". */
+bool stdin_reader_wait(Stdin_Reader* r, int timeout_ms) {
+    if (stdin_reader__has_line(r)) return true;
+    int64_t deadline = get_time_ns() + (int64_t)timeout_ms*1000000;
+    for (int remaining = timeout_ms;;) {
+        if (r->eof) {
+            if (remaining != 0) poll(NULL, 0, remaining);
+            return false;
+        }
+        struct pollfd pfd = {.fd = STDIN_FILENO, .events = POLLIN};
+        if (poll(&pfd, 1, remaining) > 0) {
+            stdin_reader__fill(r);
+            if (stdin_reader__has_line(r)) return true;
+        }
+        if (timeout_ms < 0) continue;
+        int64_t left_ns = deadline - get_time_ns();
+        if (left_ns <= 0) return false;
+        remaining = (int)((left_ns + 999999)/1000000);
+    }
+}
+
+/* Pops the next complete line from the buffer, never makes syscalls. */
+bool stdin_reader_next_line(Stdin_Reader* r, Line* line) {
+    if (!stdin_reader__has_line(r)) return false;
+    char* nl = memchr(r->buf + r->scan, '\n', r->end - r->scan);
+    line->items = r->buf + r->start;
+    if (nl == NULL) {
+        nl = r->buf + r->end;
+        r->start = r->scan = r->end;
+    } else {
+        r->start = r->scan = nl - r->buf + 1;
+    }
+    *nl = '\0';
+    line->count = nl - line->items;
+    if (line->count > 0 && line->items[line->count-1] == '\r') {
+        line->items[--line->count] = '\0';
+    }
+    return true;
+}
+
+void stdin_reader_free(Stdin_Reader* r) {
+    (void)r;
+    set_stdin_blocking();
+}
+
+/* Line parsers, they skip leading whitespace and advance the line on success */
+bool line_next_long(Line* line, long* out) {
+    char* end;
+    errno = 0;
+    long value = strtol(line->items, &end, 10);
+    if (end == line->items || errno == ERANGE) return false;
+    line->count -= end - line->items;
+    line->items  = end;
+    *out = value;
+    return true;
+}
+
+bool line_next_double(Line* line, double* out) {
+    char* end;
+    errno = 0;
+    double value = strtod(line->items, &end);
+    // Underflow is fine (scanf takes 1e-400 too), only overflow is rejected
+    if (end == line->items || (errno == ERANGE && fabs(value) == HUGE_VAL)) return false;
+    line->count -= end - line->items;
+    line->items  = end;
+    *out = value;
+    return true;
+}
+
+bool line_next_word(Line* line, Line* word) {
+    while (line->count > 0 && isspace((unsigned char)*line->items)) {
+        line->items++;
+        line->count--;
+    }
+    if (line->count == 0) return false;
+    word->items = line->items;
+    while (line->count > 0 && !isspace((unsigned char)*line->items)) {
+        line->items++;
+        line->count--;
+    }
+    word->count = line->items - word->items;
+    return true;
+}
+
 #elif defined(_WIN32)
 
 void clear_line() {
@@ -247,3 +414,191 @@ bool nonblocking_scanf(int* ret, const char* fmt, ...) {
 }
 
 #endif
+
+/* tag Random */
+
+/* xoshiro256** (Blackman & Vigna), one state per thread, no locks.
+ * Streams are split in two levels off a single seed so runs stay reproducible:
+ * rng_long_jump() skips 2^192 outputs and separates threads, rng_jump() skips
+ * 2^128 and separates the SIMD lanes inside a thread. Up to 2^64 lanes fit
+ * between two threads, so no lane ever overlaps another thread's streams.
+ */
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+#if defined(_MSC_VER)
+#    define RNG_THREAD_LOCAL __declspec(thread)
+#else
+#    define RNG_THREAD_LOCAL _Thread_local
+#endif
+
+static inline uint64_t rng__rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng__splitmix64(uint64_t* x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(Rng* rng, uint64_t seed) {
+    for (int i = 0; i < 4; ++i) rng->s[i] = rng__splitmix64(&seed);
+}
+
+static inline uint64_t rng_next(Rng* rng) {
+    uint64_t* s = rng->s;
+    uint64_t result = rng__rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng__rotl(s[3], 45);
+    return result;
+}
+
+static void rng__jump(Rng* rng, const uint64_t table[4]) {
+    uint64_t s[4] = {0};
+    for (int i = 0; i < 4; ++i) {
+        for (int b = 0; b < 64; ++b) {
+            if (table[i] & (1ULL << b)) {
+                for (int j = 0; j < 4; ++j) s[j] ^= rng->s[j];
+            }
+            rng_next(rng);
+        }
+    }
+    memcpy(rng->s, s, sizeof(s));
+}
+
+void rng_jump(Rng* rng) {
+    static const uint64_t JUMP[] = {
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+        0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL,
+    };
+    rng__jump(rng, JUMP);
+}
+
+void rng_long_jump(Rng* rng) {
+    static const uint64_t LONG_JUMP[] = {
+        0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL,
+        0x77710069854ee241ULL, 0x39109bb02acbe635ULL,
+    };
+    rng__jump(rng, LONG_JUMP);
+}
+
+/* [0,1): the top 23/52 bits become the mantissa of a number in [1,2), then
+ * subtract 1. Only integer ops and a subtract, so the batch loops vectorize
+ * even where there's no 64 bit int to float instruction (AVX2). */
+static inline float rng__to_float(uint64_t x) {
+    uint32_t bits = (uint32_t)(x >> 41) | 0x3f800000u;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f - 1.0f;
+}
+
+static inline double rng__to_double(uint64_t x) {
+    uint64_t bits = (x >> 12) | 0x3ff0000000000000ULL;
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d - 1.0;
+}
+
+static inline float  rng_float (Rng* rng) { return rng__to_float (rng_next(rng)); }
+static inline double rng_double(Rng* rng) { return rng__to_double(rng_next(rng)); }
+
+/* Per thread generator used by randfloat(). Call rng_thread_seed(seed, thread_index)
+ * at the start of each thread for reproducible runs, otherwise it seeds itself
+ * from the clock and its own address on first use. */
+static RNG_THREAD_LOCAL Rng  rng__thread;
+static RNG_THREAD_LOCAL bool rng__thread_seeded = false;
+
+void rng_thread_seed(uint64_t seed, size_t thread_index) {
+    rng_seed(&rng__thread, seed);
+    for (size_t i = 0; i < thread_index; ++i) rng_long_jump(&rng__thread);
+    rng__thread_seeded = true;
+}
+
+static inline Rng* rng_thread(void) {
+    if (!rng__thread_seeded) {
+        rng_seed(&rng__thread, (uint64_t)get_time_ns() ^ (uint64_t)(uintptr_t)&rng__thread);
+        rng__thread_seeded = true;
+    }
+    return &rng__thread;
+}
+
+/* Batch generation: RNG_LANES independent xoshiro256** streams stored lane by
+ * lane, so the inner loops below map onto SIMD registers (4 lanes = one AVX2
+ * register per state word, 8 = AVX-512). Output is reproducible for a given
+ * seed and RNG_LANES, but a tail shorter than RNG_LANES discards the rest of
+ * its block, so split work in multiples of RNG_LANES to get identical streams.
+ */
+#ifndef RNG_LANES
+#define RNG_LANES 8
+#endif
+
+typedef struct {
+    uint64_t s[4][RNG_LANES];
+} Rng_Lanes;
+
+/* Lane i starts at rng jumped i times, rng is left one jump past the last lane.
+ * Pass the thread's generator (rng_thread()) so lanes stay within its stream. */
+void rng_lanes_init(Rng_Lanes* lanes, Rng* rng) {
+    for (int lane = 0; lane < RNG_LANES; ++lane) {
+        for (int i = 0; i < 4; ++i) lanes->s[i][lane] = rng->s[i];
+        rng_jump(rng);
+    }
+}
+
+static inline void rng_lanes_next(Rng_Lanes* lanes, uint64_t out[RNG_LANES]) {
+    uint64_t (*s)[RNG_LANES] = lanes->s;
+    for (int l = 0; l < RNG_LANES; ++l) {
+        out[l] = rng__rotl(s[1][l] * 5, 7) * 9;
+        uint64_t t = s[1][l] << 17;
+        s[2][l] ^= s[0][l];
+        s[3][l] ^= s[1][l];
+        s[1][l] ^= s[2][l];
+        s[0][l] ^= s[3][l];
+        s[2][l] ^= t;
+        s[3][l] = rng__rotl(s[3][l], 45);
+    }
+}
+
+void rng_fill_u64(Rng_Lanes* lanes, uint64_t* out, size_t count) {
+    uint64_t block[RNG_LANES];
+    size_t i = 0;
+    for (; i + RNG_LANES <= count; i += RNG_LANES) rng_lanes_next(lanes, out + i);
+    if (i < count) {
+        rng_lanes_next(lanes, block);
+        memcpy(out + i, block, (count - i)*sizeof(*out));
+    }
+}
+
+void rng_fill_float(Rng_Lanes* lanes, float* out, size_t count) {
+    uint64_t block[RNG_LANES];
+    size_t i = 0;
+    for (; i + RNG_LANES <= count; i += RNG_LANES) {
+        rng_lanes_next(lanes, block);
+        for (int l = 0; l < RNG_LANES; ++l) out[i + l] = rng__to_float(block[l]);
+    }
+    if (i < count) {
+        rng_lanes_next(lanes, block);
+        for (size_t l = 0; l < count - i; ++l) out[i + l] = rng__to_float(block[l]);
+    }
+}
+
+void rng_fill_double(Rng_Lanes* lanes, double* out, size_t count) {
+    uint64_t block[RNG_LANES];
+    size_t i = 0;
+    for (; i + RNG_LANES <= count; i += RNG_LANES) {
+        rng_lanes_next(lanes, block);
+        for (int l = 0; l < RNG_LANES; ++l) out[i + l] = rng__to_double(block[l]);
+    }
+    if (i < count) {
+        rng_lanes_next(lanes, block);
+        for (size_t l = 0; l < count - i; ++l) out[i + l] = rng__to_double(block[l]);
+    }
+}